@@ -0,0 +1,282 @@
+#include <stdint.h>
+#include "onewire-slave-sim.h"
+
+// Simulated physical layer. See onewire-slave-sim.h for how to use it.
+// The simulation works on a time axis in microseconds. The master generates its slots one
+// after another; every edge on the bus results in a call of the attached edge callback
+// which happens 'Interrupt_Latency' after the edge (or later, if the previous interrupt
+// was still running at that time).
+
+const OneWireSim_TimingTypeDef OneWireSim_Standard_Timing = {
+    .Reset_Low = 480,
+    .Presence_Sample = 70,
+    .Reset_Slot = 960,
+    .Write_One_Low = 6,
+    .Write_Zero_Low = 60,
+    .Read_Low = 6,
+    .Read_Sample = 15,
+    .Slot = 70,
+    .Recovery = 10,
+    .Interrupt_Latency = 2,
+};
+
+static const OneWireSim_TimingTypeDef *Sim_Timing = &OneWireSim_Standard_Timing;
+static OneWireSim_Edge_Callback Sim_Edge_Callback = 0;
+static void *Sim_Slave = 0;
+static OneWireSim_StatsTypeDef Sim_Stats;
+
+static __uint32_t Sim_Now;         // time as seen by the slave (inside of interrupts)
+static __uint32_t Sim_Timer_Start; // time of the last call to Start_Time_Meassurement()
+static __uint32_t Sim_Bus_Free_At; // earliest time the master can start the next slot
+
+// The bus is low while the master or the slave pulls it low: [From, Until)
+static __uint32_t Sim_Master_Low_From;
+static __uint32_t Sim_Master_Low_Until;
+static __uint32_t Sim_Slave_Low_From;
+static __uint32_t Sim_Slave_Low_Until;
+static __uint8_t Sim_Slave_Pulse_Pending; // Send_Signal() was called but the edges of its pulse were not generated yet
+
+// The master samples the bus once per slot
+static __uint32_t Sim_Sample_At;
+static __uint8_t Sim_Sampled_Low;
+
+// Answer for the next read slot (pre-armed mode)
+static __uint8_t Sim_Armed_Bit;
+static __uint8_t Sim_Previous_Armed_Bit;
+static __uint32_t Sim_Armed_At;
+
+void OneWireSim_Init(const OneWireSim_TimingTypeDef *timing)
+{
+    Sim_Timing = timing;
+
+    Sim_Stats.Read_Slots = 0;
+    Sim_Stats.Missed_Deadlines = 0;
+    Sim_Stats.Min_Rearm_Margin = 0xFFFFFFFF;
+
+    Sim_Now = 0;
+    Sim_Timer_Start = 0;
+    Sim_Bus_Free_At = 0;
+    Sim_Master_Low_From = 0;
+    Sim_Master_Low_Until = 0;
+    Sim_Slave_Low_From = 0;
+    Sim_Slave_Low_Until = 0;
+    Sim_Slave_Pulse_Pending = 0;
+
+    Sim_Armed_Bit = 1;
+    Sim_Previous_Armed_Bit = 1;
+    Sim_Armed_At = 0;
+}
+
+void OneWireSim_Attach(OneWireSim_Edge_Callback callback, void *slave)
+{
+    Sim_Edge_Callback = callback;
+    Sim_Slave = slave;
+}
+
+//************************************
+//          SIMULATED BUS
+//************************************
+
+// The slave starts pulling the bus low for the given duration.
+// Returns true, if the master sees this pulse when it samples the bus.
+static __uint8_t Sim_Slave_Pulse(__uint32_t from, __uint32_t duration)
+{
+    Sim_Slave_Low_From = from;
+    Sim_Slave_Low_Until = from + duration;
+    if (Sim_Slave_Low_From <= Sim_Sample_At && Sim_Sample_At < Sim_Slave_Low_Until)
+    {
+        Sim_Sampled_Low = 1;
+        return 1;
+    }
+    return 0;
+}
+
+static void Sim_Interrupt(__uint32_t edge, OneWire_Pin_State pin_state)
+{
+    // interrupts can't overtake each other
+    if (edge + Sim_Timing->Interrupt_Latency > Sim_Now)
+    {
+        Sim_Now = edge + Sim_Timing->Interrupt_Latency;
+    }
+    if (Sim_Edge_Callback)
+    {
+        Sim_Edge_Callback(Sim_Slave, pin_state);
+    }
+}
+
+// Generates one time slot in which the master pulls the bus low for 'low_time'.
+// Returns the state of the bus 'sample_time' after the falling edge (1 = high).
+static __uint8_t Sim_Slot(__uint32_t low_time, __uint32_t sample_time, __uint32_t slot_time, __uint8_t is_read_slot)
+{
+    __uint32_t start = Sim_Bus_Free_At;
+    __uint32_t rise;
+
+    Sim_Master_Low_From = start;
+    Sim_Master_Low_Until = start + low_time;
+    Sim_Slave_Low_From = start;
+    Sim_Slave_Low_Until = start;
+    Sim_Slave_Pulse_Pending = 0;
+    Sim_Sample_At = start + sample_time;
+    Sim_Sampled_Low = (sample_time < low_time) ? 1 : 0;
+
+    if (is_read_slot)
+    {
+        Sim_Stats.Read_Slots++;
+    }
+
+#if ONEWIRE_PREARMED_READ_SLOTS
+    // The one-pulse timer reacts on the falling edge without any help of the software.
+    // If the software re-armed it too late, the timer still holds the previous bit.
+    __uint8_t armed_bit = Sim_Armed_Bit;
+    if (Sim_Armed_At > start)
+    {
+        armed_bit = Sim_Previous_Armed_Bit;
+        if (is_read_slot)
+        {
+            Sim_Stats.Missed_Deadlines++;
+        }
+    }
+    else if (is_read_slot && start - Sim_Armed_At < Sim_Stats.Min_Rearm_Margin)
+    {
+        Sim_Stats.Min_Rearm_Margin = start - Sim_Armed_At;
+    }
+    if (!armed_bit)
+    {
+        Sim_Slave_Pulse(start, ONEWIRE_WRITE_ZERO_LOW_TIME);
+    }
+#endif
+
+    Sim_Interrupt(start, PIN_LOW);
+
+    // the bus gets high again as soon as nobody pulls it low anymore
+    rise = Sim_Master_Low_Until;
+    if (Sim_Slave_Low_From <= rise && Sim_Slave_Low_Until > rise)
+    {
+        rise = Sim_Slave_Low_Until;
+        Sim_Slave_Pulse_Pending = 0; // this pulse was hidden by the master's one
+    }
+    Sim_Interrupt(rise, PIN_HIGH);
+
+    // our own signals that start after the master released the bus (e.g. presence) cause further edges
+    while (Sim_Slave_Pulse_Pending)
+    {
+        Sim_Slave_Pulse_Pending = 0;
+        Sim_Interrupt(Sim_Slave_Low_From, PIN_LOW);
+        rise = Sim_Slave_Low_Until;
+        Sim_Interrupt(rise, PIN_HIGH);
+    }
+
+    Sim_Bus_Free_At = start + slot_time;
+    if (rise + Sim_Timing->Recovery > Sim_Bus_Free_At)
+    {
+        Sim_Bus_Free_At = rise + Sim_Timing->Recovery;
+    }
+
+    return (Sim_Sampled_Low) ? 0 : 1;
+}
+
+//************************************
+//          SIMULATED MASTER
+//************************************
+
+__uint8_t OneWireSim_Master_Reset(void)
+{
+    // presence = bus is low when the master samples it
+    return !Sim_Slot(Sim_Timing->Reset_Low, Sim_Timing->Reset_Low + Sim_Timing->Presence_Sample, Sim_Timing->Reset_Slot, 0);
+}
+
+void OneWireSim_Master_Write_Bit(__uint8_t bit)
+{
+    __uint32_t low_time = (bit) ? Sim_Timing->Write_One_Low : Sim_Timing->Write_Zero_Low;
+    Sim_Slot(low_time, low_time, Sim_Timing->Slot, 0);
+}
+
+void OneWireSim_Master_Write_Byte(__uint8_t byte)
+{
+    for (int i = 0; i < 8; i++)
+    {
+        OneWireSim_Master_Write_Bit(byte & (1 << i)); // LSB first
+    }
+}
+
+__uint8_t OneWireSim_Master_Read_Bit(void)
+{
+    return Sim_Slot(Sim_Timing->Read_Low, Sim_Timing->Read_Sample, Sim_Timing->Slot, 1);
+}
+
+__uint8_t OneWireSim_Master_Read_Byte(void)
+{
+    __uint8_t byte = 0;
+    for (int i = 0; i < 8; i++)
+    {
+        if (OneWireSim_Master_Read_Bit())
+        {
+            byte |= (__uint8_t)(1 << i); // LSB first
+        }
+    }
+    return byte;
+}
+
+__uint32_t OneWireSim_Get_Time(void)
+{
+    return Sim_Now;
+}
+
+const OneWireSim_StatsTypeDef *OneWireSim_Get_Stats(void)
+{
+    return &Sim_Stats;
+}
+
+//************************************
+//          PHYSICAL LAYER
+//  (implementation for the library)
+//************************************
+
+void Init_Timers(void)
+{
+    // the simulated time is reset by OneWireSim_Init()
+}
+
+void Send_Signal(__uint32_t Pin, __uint32_t duration_in_us)
+{
+    (void)Pin;
+
+    // In contrast to the STM32 implementation this does not block: the pulse is put on
+    // the simulated bus and its edges are generated after the current interrupt.
+    if (!Sim_Slave_Pulse(Sim_Now, duration_in_us))
+    {
+        Sim_Stats.Missed_Deadlines++; // the master has already sampled (or will never sample) this pulse
+    }
+    Sim_Slave_Pulse_Pending = 1;
+}
+
+void Start_Time_Meassurement(void)
+{
+    Sim_Timer_Start = Sim_Now;
+}
+
+__uint32_t Get_Elapsed_Time_In_Microseconds(void)
+{
+    return Sim_Now - Sim_Timer_Start;
+}
+
+OneWire_Pin_State Get_Pin_State(__uint32_t Pin)
+{
+    (void)Pin;
+
+    if ((Sim_Master_Low_From <= Sim_Now && Sim_Now < Sim_Master_Low_Until) ||
+        (Sim_Slave_Low_From <= Sim_Now && Sim_Now < Sim_Slave_Low_Until))
+    {
+        return PIN_LOW;
+    }
+    return PIN_HIGH;
+}
+
+void Arm_Read_Slot(__uint32_t Pin, __uint8_t bit)
+{
+    (void)Pin;
+
+    Sim_Previous_Armed_Bit = Sim_Armed_Bit;
+    Sim_Armed_Bit = (bit) ? 1 : 0;
+    Sim_Armed_At = Sim_Now;
+}
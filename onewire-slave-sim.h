@@ -0,0 +1,114 @@
+#ifndef __ONE_WIRE_SLAVE_SIM_H__
+#define __ONE_WIRE_SLAVE_SIM_H__
+
+#include "onewire-slave.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+    /*
+     * Simulated physical layer for running this library on a host (e.g. Linux).
+     * Build onewire-slave.c and onewire-slave-sim.c with -DONEWIRE_SIMULATED_BUS (and optionally
+     * -DONEWIRE_PREARMED_READ_SLOTS=1). Instead of real interrupts, the functions below play the
+     * role of the master: they generate the edges of a time slot on a simulated time axis and call
+     * the edge callback of the attached slave for every edge, delayed by the configured interrupt latency.
+     * This way the timing of the slave (and especially the re-arming of pre-armed read slots) can
+     * be checked without hardware.
+     */
+
+    /*
+     * Timing of the simulated bus. All values in microseconds.
+     */
+    typedef struct
+    {
+        __uint32_t Reset_Low;         // how long the master pulls the bus low for a 'RESET'
+        __uint32_t Presence_Sample;   // when the master samples the presence signal (after releasing the bus)
+        __uint32_t Reset_Slot;        // duration of the whole reset sequence (falling edge to next falling edge)
+        __uint32_t Write_One_Low;     // how long the master pulls the bus low for writing a "1"
+        __uint32_t Write_Zero_Low;    // how long the master pulls the bus low for writing a "0"
+        __uint32_t Read_Low;          // how long the master pulls the bus low for a read slot
+        __uint32_t Read_Sample;       // when the master samples the bus in a read slot (after the falling edge)
+        __uint32_t Slot;              // minimal duration of a time slot (falling edge to next falling edge)
+        __uint32_t Recovery;          // minimal time the bus is high between two slots
+        __uint32_t Interrupt_Latency; // time between an edge on the bus and the call of the edge callback
+    } OneWireSim_TimingTypeDef;
+
+    /*
+     * What happened on the simulated bus since the last call to OneWireSim_Init().
+     */
+    typedef struct
+    {
+        __uint32_t Read_Slots;       // number of read slots generated by the master
+        __uint32_t Missed_Deadlines; // answers the master could not see, see below
+        __uint32_t Min_Rearm_Margin; // smallest time between re-arming and the following falling edge (pre-armed mode only)
+    } OneWireSim_StatsTypeDef;
+    /*
+     * A deadline is missed if
+     *  - pre-armed mode: the one-pulse timer was re-armed after the falling edge of a read slot, so it
+     *    answered with the previous bit.
+     *  - software mode: a pulse sent with Send_Signal() does not cover the point where the master samples
+     *    the bus. If such a pulse starts after the master released the bus, the slave takes its edges
+     *    for another read slot and sends (and probably misses) the following bit as well - so every
+     *    bit that got lost this way is counted.
+     * The simulated one-pulse timer pulls the bus low for ONEWIRE_WRITE_ZERO_LOW_TIME, just like the
+     * real one.
+     */
+
+    // Timing of a standard speed master, as recommended in https://www.maximintegrated.com/en/app-notes/index.mvp/id/126
+    extern const OneWireSim_TimingTypeDef OneWireSim_Standard_Timing;
+
+    /*
+     * Called for every edge on the simulated bus (like the EXTI handler on the real device).
+     * 'slave' is the pointer passed to OneWireSim_Attach().
+     */
+    typedef void (*OneWireSim_Edge_Callback)(void *slave, OneWire_Pin_State pin_state);
+
+    // Edge callback for slaves of the C library: attach it with the handle as 'slave'.
+    static inline void OneWireSim_C_Edge_Callback(void *slave, OneWire_Pin_State pin_state)
+    {
+        OneWire_Interrupt_Callback((OneWireSlave_HandleTypeDef *)slave, pin_state);
+    }
+
+    /*
+     * Resets the simulated time, the bus and the statistics and uses the given timing from now on.
+     * Call this before OneWireSlave_Init().
+     */
+    void OneWireSim_Init(const OneWireSim_TimingTypeDef *timing);
+
+    /*
+     * Puts the given slave on the bus: all edges from now on are passed to 'callback'.
+     * E.g. OneWireSim_Attach(OneWireSim_C_Edge_Callback, &h1ws) for a C handle, or a function
+     * calling Interrupt_Callback() of a C++ OneWireSlave.
+     */
+    void OneWireSim_Attach(OneWireSim_Edge_Callback callback, void *slave);
+
+    /*
+     * The master sends a 'RESET' signal. Returns 1 if the slave answered with a presence signal.
+     */
+    __uint8_t OneWireSim_Master_Reset(void);
+
+    /*
+     * The master writes a single bit / a byte (LSB first) to the bus.
+     */
+    void OneWireSim_Master_Write_Bit(__uint8_t bit);
+    void OneWireSim_Master_Write_Byte(__uint8_t byte);
+
+    /*
+     * The master generates read slots and returns what it sampled (LSB first for bytes).
+     */
+    __uint8_t OneWireSim_Master_Read_Bit(void);
+    __uint8_t OneWireSim_Master_Read_Byte(void);
+
+    // Returns the current simulated time in microseconds.
+    __uint32_t OneWireSim_Get_Time(void);
+
+    // Returns the statistics collected since OneWireSim_Init().
+    const OneWireSim_StatsTypeDef *OneWireSim_Get_Stats(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __ONE_WIRE_SLAVE_SIM_H__ */
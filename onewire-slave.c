@@ -1,3 +1,4 @@
+#ifndef ONEWIRE_SIMULATED_BUS
 #include "stm32f7xx_hal.h"
 #include "stm32f7xx_hal_def.h"
 #include "onewire-slave.h"
@@ -5,6 +6,12 @@
 
 // TODO: remove when tests with LEDs are over:
 #include "main.h"
+#else
+// Host build: the physical layer is provided by onewire-slave-sim.c
+#include <stdint.h>
+#include "onewire-slave.h"
+#define __weak __attribute__((weak))
+#endif
 
 // Book of iButton Standards:
 // https://pdfserv.maximintegrated.com/en/an/AN937.pdf
@@ -14,13 +21,12 @@ OneWireSlave_HandleTypeDef *OneWireInstances[MAX_ONEWIRE_INSTANCES] = {0};
 
 void OneWireSlave_Init(OneWireSlave_HandleTypeDef *h1ws)
 {
-    // Init timer for delay
-    __HAL_RCC_TIM4_CLK_ENABLE();
-    TIM4->PSC = HAL_RCC_GetPCLK1Freq() / 500000 - 1; // 1 tick = 1 microsecond
-    TIM4->CR1 = TIM_CR1_CEN;
+    Init_Timers();
 
     // Set initial state
     h1ws->LL_State = ONEWIRE_R_IDLE;
+    h1ws->ROM_State = ONEWIRE_WAIT; // until the first 'RESET'
+    h1ws->Byte_Handler = 0;
 
     // Add itself to the global list of active OneWire instances
     for (int i = 0; i < MAX_ONEWIRE_INSTANCES; i++)
@@ -30,9 +36,9 @@ void OneWireSlave_Init(OneWireSlave_HandleTypeDef *h1ws)
             OneWireInstances[i] = h1ws;
             break;
         }
-        else if (i == MAX_ONEWIRE_INSTANCES)
+        else if (i == MAX_ONEWIRE_INSTANCES - 1)
         {
-            // all instances are used up!
+            // all instances are used up! -> this handle won't get any interrupts (raise MAX_ONEWIRE_INSTANCES)
             // TODO: ERROR!
         }
     }
@@ -55,13 +61,23 @@ void OneWireSlave_DeInit(OneWireSlave_HandleTypeDef *h1ws)
 //       HIGH LEVEL ONEWIRE
 //************************************
 
+// Switches to sending mode. With pre-armed read slots, the first bit is handed to the
+// hardware right away because the master may ask for it any moment.
+static inline void OneWire_Start_Writing(OneWireSlave_HandleTypeDef *h1ws)
+{
+    h1ws->LL_State = ONEWIRE_W_IDLE;
+#if ONEWIRE_PREARMED_READ_SLOTS
+    Arm_Read_Slot(h1ws->Init.Pin, h1ws->SendDataBuffer[h1ws->SendDataBuffer_Pos] & h1ws->SendDataBuffer_BitPos);
+#endif
+}
+
 void OneWire_Send(OneWireSlave_HandleTypeDef *h1ws, __uint8_t *message, __uint16_t message_length)
 {
     h1ws->SendDataBuffer = message;
     h1ws->SendDataBuffer_Length = message_length;
     h1ws->SendDataBuffer_Pos = 0;
     h1ws->SendDataBuffer_BitPos = 0x01;
-    h1ws->LL_State = ONEWIRE_W_IDLE;
+    OneWire_Start_Writing(h1ws);
 }
 
 void OneWire_SendBit(OneWireSlave_HandleTypeDef *h1ws, __uint8_t bit)
@@ -71,7 +87,17 @@ void OneWire_SendBit(OneWireSlave_HandleTypeDef *h1ws, __uint8_t bit)
     h1ws->SendDataBuffer_Length = 1;
     h1ws->SendDataBuffer_Pos = 0;
     h1ws->SendDataBuffer_BitPos = 0x80;
-    h1ws->LL_State = ONEWIRE_W_IDLE;
+    OneWire_Start_Writing(h1ws);
+}
+
+void OneWire_Register_Command_Handler(OneWire_Command_Table *table, __uint8_t command, OneWire_Command_Handler handler)
+{
+    table->Handlers[command] = handler;
+}
+
+void OneWire_Set_Byte_Handler(OneWireSlave_HandleTypeDef *h1ws, OneWire_Byte_Handler handler)
+{
+    h1ws->Byte_Handler = handler;
 }
 
 /* NOTE: This function Should not be modified, when the callback is needed,
@@ -121,6 +147,21 @@ __weak void OneWire_Reset_Received_Callback(OneWireSlave_HandleTypeDef *h1ws)
 //    ROM / HIGH LEVEL STATE MACHINE
 //************************************
 
+// Looks up the handler of a function command in the command table of this handle.
+// Commands without a handler are passed to the (weak) byte callback as before.
+static inline void OneWire_Dispatch_Function_Command(OneWireSlave_HandleTypeDef *h1ws, __uint8_t command)
+{
+    const OneWire_Command_Table *table = h1ws->Init.Command_Table;
+    if (table && table->Handlers[command])
+    {
+        table->Handlers[command](h1ws, command);
+    }
+    else
+    {
+        OneWire_Byte_Received_Callback(h1ws, command);
+    }
+}
+
 void OneWire_Received_Command(OneWireSlave_HandleTypeDef *h1ws)
 {
 
@@ -137,7 +178,7 @@ void OneWire_Received_Command(OneWireSlave_HandleTypeDef *h1ws)
         h1ws->SendDataBuffer_Length = 1;
         h1ws->SendDataBuffer_Pos = 0;
         h1ws->SendDataBuffer_BitPos = (__uint8_t)0x40;
-        h1ws->LL_State = ONEWIRE_W_IDLE;
+        OneWire_Start_Writing(h1ws);
 
         h1ws->ROM_State = ONEWIRE_SEARCH_ROM;
         break;
@@ -150,20 +191,19 @@ void OneWire_Received_Command(OneWireSlave_HandleTypeDef *h1ws)
         h1ws->SendDataBuffer_Length = 1;
         h1ws->SendDataBuffer_Pos = 0;
         h1ws->SendDataBuffer_BitPos = (__uint8_t)0x40;
-        h1ws->LL_State = ONEWIRE_W_IDLE;
+        OneWire_Start_Writing(h1ws);
 
         h1ws->ROM_State = ONEWIRE_ALARM_SEARCH;
         break;
     case 0x33: // READ ROM
         // send family code + serial number + CRC of ROM
-        // -> we need to reverse the ROM to get this ordering
-        h1ws->Internal_Buffer[0] = 0; // do anything here except a declaration (next line) because C does not allow declarations after labels ¯\_(ツ)_/¯
-        __uint64_t mask = (__uint64_t)0xFF;
-        for(int i=0;i<8;i++) {
-            h1ws->Internal_Buffer[i] = ((h1ws->Init.ROM_Address & mask) << (7-i)*8);
-            mask = mask << 8;
+        // -> the family code is in the lowest byte of the ROM, so we start there
+        for (int i = 0; i < 8; i++)
+        {
+            h1ws->Internal_Buffer[i] = (__uint8_t)(h1ws->Init.ROM_Address >> (i * 8));
         }
         OneWire_Send(h1ws, h1ws->Internal_Buffer, 8);
+        h1ws->ROM_State = ONEWIRE_READING_FUNCTION_COMMAND;
         break;
     case 0x55: // MATCH ROM
         // Begin with LSB
@@ -171,9 +211,10 @@ void OneWire_Received_Command(OneWireSlave_HandleTypeDef *h1ws)
         h1ws->ROM_State = ONEWIRE_MATCH_ROM;
         break;
     case 0xCC: // SKIP ROM
+        h1ws->ROM_State = ONEWIRE_READING_FUNCTION_COMMAND;
         break;
-    default: // invoke interrupt for handling this command
-        OneWire_Byte_Received_Callback(h1ws, h1ws->ReceiveBuffer);
+    default: // not a ROM command -> treat it as function command
+        OneWire_Dispatch_Function_Command(h1ws, h1ws->ReceiveBuffer);
         break;
     }
 }
@@ -196,6 +237,20 @@ void Process_Received_Bit(OneWireSlave_HandleTypeDef *h1ws, __uint8_t bit)
             h1ws->ReceiveBuffer_BitPos = (__uint8_t)0x01; // data is sent LSB first in 1-wire
         }
         break;
+    case ONEWIRE_READING_FUNCTION_COMMAND: // Read function command (first byte after ROM phase)
+        // store bit in receive buffer
+        h1ws->ReceiveBuffer |= (h1ws->ReceiveBuffer_BitPos & ((bit) ? (__uint8_t)0xFF : (__uint8_t)0x00));
+
+        // advance buffer to next bit
+        h1ws->ReceiveBuffer_BitPos = h1ws->ReceiveBuffer_BitPos << 1; // LSB byte order!
+        if (!h1ws->ReceiveBuffer_BitPos)                              // buffer is full
+        {
+            h1ws->ROM_State = ONEWIRE_READING_BITS;
+            OneWire_Dispatch_Function_Command(h1ws, h1ws->ReceiveBuffer);
+            h1ws->ReceiveBuffer = 0;
+            h1ws->ReceiveBuffer_BitPos = (__uint8_t)0x01; // data is sent LSB first in 1-wire
+        }
+        break;
     case ONEWIRE_READING_BITS: // Read payload data
         // store bit in receive buffer
         h1ws->ReceiveBuffer |= (h1ws->ReceiveBuffer_BitPos & ((bit) ? (__uint8_t)0xFF : (__uint8_t)0x00));
@@ -205,7 +260,14 @@ void Process_Received_Bit(OneWireSlave_HandleTypeDef *h1ws, __uint8_t bit)
         if (!h1ws->ReceiveBuffer_BitPos)                              // buffer is full
         {
             h1ws->ROM_State = ONEWIRE_READING_BITS;
-            OneWire_Byte_Received_Callback(h1ws, h1ws->ReceiveBuffer);
+            if (h1ws->Byte_Handler)
+            {
+                h1ws->Byte_Handler(h1ws, h1ws->ReceiveBuffer);
+            }
+            else
+            {
+                OneWire_Byte_Received_Callback(h1ws, h1ws->ReceiveBuffer);
+            }
             h1ws->ReceiveBuffer = 0;
             h1ws->ReceiveBuffer_BitPos = (__uint8_t)0x01; // data is sent LSB first in 1-wire
         }
@@ -216,8 +278,8 @@ void Process_Received_Bit(OneWireSlave_HandleTypeDef *h1ws, __uint8_t bit)
             h1ws->ROM_Mask = h1ws->ROM_Mask << 1;
             if (!h1ws->ROM_Mask) // whole ROM has been compared
             {
-                // Listen for next byte
-                h1ws->ROM_State = ONEWIRE_READING_BITS;
+                // We are selected -> listen for the function command
+                h1ws->ROM_State = ONEWIRE_READING_FUNCTION_COMMAND;
             }
         }
         else
@@ -232,8 +294,8 @@ void Process_Received_Bit(OneWireSlave_HandleTypeDef *h1ws, __uint8_t bit)
             h1ws->ROM_Mask = h1ws->ROM_Mask << 1;
             if (!h1ws->ROM_Mask) // whole ROM has been compared
             {
-                // Listen for next byte
-                h1ws->ROM_State = ONEWIRE_READING_BITS;
+                // The master found us and we are selected (like after MATCH ROM) -> listen for the function command
+                h1ws->ROM_State = ONEWIRE_READING_FUNCTION_COMMAND;
             } else {
                 // write next LSB bit of ROM and its complement to bus
                 h1ws->Internal_Buffer[0] = (h1ws->Init.ROM_Address & h1ws->ROM_Mask) ? (__uint8_t)0x40 : (__uint8_t)0x80;
@@ -241,7 +303,7 @@ void Process_Received_Bit(OneWireSlave_HandleTypeDef *h1ws, __uint8_t bit)
                 h1ws->SendDataBuffer_Length = 1;
                 h1ws->SendDataBuffer_Pos = 0;
                 h1ws->SendDataBuffer_BitPos = (__uint8_t)0x40;
-                h1ws->LL_State = ONEWIRE_W_IDLE;
+                OneWire_Start_Writing(h1ws);
             }
         }
         else
@@ -267,13 +329,14 @@ void OneWire_Process_Reset_Signal(OneWireSlave_HandleTypeDef *h1ws)
     h1ws->SendDataBuffer_Pos = 0;
     h1ws->SendDataBuffer_BitPos = (__uint8_t)0x01;
     h1ws->SendDataBuffer_Length = 0;
+    h1ws->Byte_Handler = 0;
 
     // invoke reset callback
     OneWire_Reset_Received_Callback(h1ws);
 }
 
 // Returns the next bit to be sent
-inline __uint8_t Get_Current_Bit_To_Send(OneWireSlave_HandleTypeDef *h1ws)
+static inline __uint8_t Get_Current_Bit_To_Send(OneWireSlave_HandleTypeDef *h1ws)
 {
     __uint8_t next_bit = h1ws->SendDataBuffer[h1ws->SendDataBuffer_Pos] & h1ws->SendDataBuffer_BitPos;
 
@@ -283,7 +346,7 @@ inline __uint8_t Get_Current_Bit_To_Send(OneWireSlave_HandleTypeDef *h1ws)
 }
 
 // Returns true, if there are still bits that need to be sent.
-inline __uint8_t Advance_To_Next_Bit_In_Buffer(OneWireSlave_HandleTypeDef *h1ws)
+static inline __uint8_t Advance_To_Next_Bit_In_Buffer(OneWireSlave_HandleTypeDef *h1ws)
 {
     h1ws->SendDataBuffer_BitPos = h1ws->SendDataBuffer_BitPos << 1; // LSB byte order!
     if (!h1ws->SendDataBuffer_BitPos)                               // we need to go to the next byte
@@ -318,7 +381,7 @@ inline __uint8_t Advance_To_Next_Bit_In_Buffer(OneWireSlave_HandleTypeDef *h1ws)
 //************************************
 
 // Returns true, if there are more bits to be sent.
-inline void Send_Next_Bit(OneWireSlave_HandleTypeDef *h1ws)
+static inline void Send_Next_Bit(OneWireSlave_HandleTypeDef *h1ws)
 {
     if (Get_Current_Bit_To_Send(h1ws))
     { // Send a "1"
@@ -326,7 +389,7 @@ inline void Send_Next_Bit(OneWireSlave_HandleTypeDef *h1ws)
     }
     else
     { // Send a "0"
-        Send_Signal(h1ws->Init.Pin, 46);
+        Send_Signal(h1ws->Init.Pin, ONEWIRE_WRITE_ZERO_LOW_TIME);
     }
 }
 
@@ -356,10 +419,10 @@ void Process_Communation_Protocol(OneWireSlave_HandleTypeDef *h1ws, OneWire_Pin_
         {
             __uint32_t time_elapsed = Get_Elapsed_Time_In_Microseconds();
             
-            if (time_elapsed <= 100) // Master sent a bit
+            if (time_elapsed <= ONEWIRE_BIT_MAX_TIME) // Master sent a bit
             {
                 __uint8_t bit = 0;
-                if (time_elapsed < 20)
+                if (time_elapsed < ONEWIRE_WRITE_ONE_MAX_TIME)
                 {
                     bit = 1; // = master sent "1"
                 }
@@ -386,7 +449,7 @@ void Process_Communation_Protocol(OneWireSlave_HandleTypeDef *h1ws, OneWire_Pin_
         if (pin_state == PIN_HIGH) // Reset signal by master is over. We now need to send our presence signal.
         {
             // send presence signal so master knows there are devices
-            Send_Signal(h1ws->Init.Pin, 100);
+            Send_Signal(h1ws->Init.Pin, ONEWIRE_PRESENCE_TIME);
 
             OneWire_Process_Reset_Signal(h1ws);
 
@@ -411,7 +474,10 @@ void Process_Communation_Protocol(OneWireSlave_HandleTypeDef *h1ws, OneWire_Pin_
         if (pin_state == PIN_LOW) // Master requests data
         {
             Start_Time_Meassurement();
+#if !ONEWIRE_PREARMED_READ_SLOTS
             Send_Next_Bit(h1ws);
+#endif
+            // else: the bit has already been sent by the hardware when the master pulled the bus low
             h1ws->LL_State = ONEWIRE_WRITING;
         }
         else
@@ -423,18 +489,28 @@ void Process_Communation_Protocol(OneWireSlave_HandleTypeDef *h1ws, OneWire_Pin_
         if (pin_state == PIN_HIGH) {
             __uint32_t time_elapsed = Get_Elapsed_Time_In_Microseconds();
             
-            if (time_elapsed > 300)
+            if (time_elapsed > ONEWIRE_RESET_WHILE_WRITING_TIME)
             { // we trapped into a reset signal
+#if ONEWIRE_PREARMED_READ_SLOTS
+                Arm_Read_Slot(h1ws->Init.Pin, 1);
+#endif
                 goto goto_reset_state;
             }
 
             if (Advance_To_Next_Bit_In_Buffer(h1ws))
             {
                 h1ws->LL_State = ONEWIRE_W_IDLE;
+#if ONEWIRE_PREARMED_READ_SLOTS
+                // re-arm for the next slot - this has to happen before the master's next falling edge
+                Arm_Read_Slot(h1ws->Init.Pin, Get_Current_Bit_To_Send(h1ws));
+#endif
             }
             else
             {
                 h1ws->LL_State = ONEWIRE_R_IDLE;
+#if ONEWIRE_PREARMED_READ_SLOTS
+                Arm_Read_Slot(h1ws->Init.Pin, 1);
+#endif
             }
         }
         break;
@@ -465,6 +541,30 @@ void OneWire_Interrupt_Callback(OneWireSlave_HandleTypeDef *h1ws, OneWire_Pin_St
 //  NEEDS TO BE IMPLEMENTED BY USER
 //************************************
 
+#ifndef ONEWIRE_SIMULATED_BUS
+
+void Init_Timers(void)
+{
+    // Init timer for delay
+    __HAL_RCC_TIM4_CLK_ENABLE();
+    TIM4->PSC = HAL_RCC_GetPCLK1Freq() / 500000 - 1; // 1 tick = 1 microsecond
+    TIM4->CR1 = TIM_CR1_CEN;
+
+#if ONEWIRE_PREARMED_READ_SLOTS
+    // Init one-pulse timer for answering read slots:
+    // a falling edge on TI1 starts the counter, CH2 pulls the bus low from CCR2 until ARR.
+    // The timer runs at full speed so the answer starts within a few ns after the master's edge.
+    __HAL_RCC_TIM3_CLK_ENABLE();
+    TIM3->PSC = 0;
+    TIM3->CCR2 = 1;
+    TIM3->ARR = 1 + (HAL_RCC_GetPCLK1Freq() / 500000) * ONEWIRE_WRITE_ZERO_LOW_TIME;
+    TIM3->CCMR1 = TIM_CCMR1_CC1S_0 | TIM_CCMR1_OC2M_2;      // CH1 = input TI1, CH2 = forced inactive until armed
+    TIM3->CCER = TIM_CCER_CC1P | TIM_CCER_CC2P | TIM_CCER_CC2E; // trigger on falling edge, output active low
+    TIM3->SMCR = TIM_SMCR_TS_0 | TIM_SMCR_TS_2 | TIM_SMCR_SMS_1 | TIM_SMCR_SMS_2; // trigger mode on TI1FP1
+    TIM3->CR1 = TIM_CR1_OPM;
+#endif
+}
+
 void Send_Signal(__uint32_t Pin, __uint32_t duration_in_us)
 {
     // in our case we connected two pins to the 1-wire bus:
@@ -484,8 +584,10 @@ void Send_Signal(__uint32_t Pin, __uint32_t duration_in_us)
     HAL_GPIO_WritePin(OneWireOutput_GPIO_Port, OneWireOutput_Pin, GPIO_PIN_SET);
 }
 
+#ifndef ONEWIRE_CUSTOM_EXTI_CALLBACK
 // Interrupt handler for GPIO pins invoked by the processor.
 // This function works for pins connected to the GPIOB
+// Define ONEWIRE_CUSTOM_EXTI_CALLBACK if you need your own handler (e.g. for the C++ front-end).
 void HAL_GPIO_EXTI_Callback(uint16_t GPIO_Pin)
 {
     // disable interrupts
@@ -499,7 +601,7 @@ void HAL_GPIO_EXTI_Callback(uint16_t GPIO_Pin)
     // If so, this instance can handle the callback.
     for (int i = 0; i < MAX_ONEWIRE_INSTANCES; i++)
     {
-        if ((__uint16_t)OneWireInstances[i]->Init.Pin == GPIO_Pin)
+        if (OneWireInstances[i] && (__uint16_t)OneWireInstances[i]->Init.Pin == GPIO_Pin)
         {
             OneWire_Interrupt_Callback(OneWireInstances[i], (pin_state)? PIN_HIGH : PIN_LOW);
             break;
@@ -509,6 +611,7 @@ void HAL_GPIO_EXTI_Callback(uint16_t GPIO_Pin)
     // enable interrupts again
     HAL_NVIC_EnableIRQ(EXTI15_10_IRQn);
 }
+#endif
 
 void Start_Time_Meassurement(void) {
     TIM4->CNT = 0;
@@ -528,3 +631,24 @@ OneWire_Pin_State Get_Pin_State(__uint32_t Pin) {
         return PIN_LOW;
     }
 }
+
+#if ONEWIRE_PREARMED_READ_SLOTS
+void Arm_Read_Slot(__uint32_t Pin, __uint8_t bit)
+{
+    // Like Send_Signal(), we ignore the pin: the TIM3 CH2 output (open drain) is wired to the bus.
+    (void)Pin;
+
+    // Only the output compare mode is switched: PWM mode 2 pulls the bus low on the next
+    // trigger, 'forced inactive' keeps it released. The counter itself stops after every pulse.
+    if (bit)
+    {
+        TIM3->CCMR1 = (TIM3->CCMR1 & ~TIM_CCMR1_OC2M) | TIM_CCMR1_OC2M_2;
+    }
+    else
+    {
+        TIM3->CCMR1 = (TIM3->CCMR1 & ~TIM_CCMR1_OC2M) | TIM_CCMR1_OC2M_2 | TIM_CCMR1_OC2M_1 | TIM_CCMR1_OC2M_0;
+    }
+}
+#endif
+
+#endif /* ONEWIRE_SIMULATED_BUS */
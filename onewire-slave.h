@@ -9,7 +9,31 @@ extern "C"
 //--------------------
 // GLOBAL CONFIG
 //--------------------
+#ifndef MAX_ONEWIRE_INSTANCES
 #define MAX_ONEWIRE_INSTANCES 1 // Maximum number of OneWire instances handled by this lib. Less is of course a little faster and requires less memory.
+#endif
+#ifndef ONEWIRE_PREARMED_READ_SLOTS
+#define ONEWIRE_PREARMED_READ_SLOTS 0 // 1: read slots are answered by a hardware one-pulse timer that is pre-armed with the next bit (see Arm_Read_Slot()). Needed for short read slots.
+#endif
+
+// Timing of the bus in microseconds. The defaults are for standard speed.
+// Note: the slave doesn't switch speeds by itself (OVERDRIVE SKIP ROM / OVERDRIVE MATCH ROM are not
+// supported). Overdrive therefore only works if all of these values are set for it at compile time.
+#ifndef ONEWIRE_WRITE_ONE_MAX_TIME
+#define ONEWIRE_WRITE_ONE_MAX_TIME 20 // Low pulses of the master shorter than this are a "1", longer ones a "0"
+#endif
+#ifndef ONEWIRE_BIT_MAX_TIME
+#define ONEWIRE_BIT_MAX_TIME 100 // Low pulses of the master longer than this are a 'RESET'
+#endif
+#ifndef ONEWIRE_RESET_WHILE_WRITING_TIME
+#define ONEWIRE_RESET_WHILE_WRITING_TIME 300 // Low pulses longer than this while we are sending are a 'RESET'
+#endif
+#ifndef ONEWIRE_WRITE_ZERO_LOW_TIME
+#define ONEWIRE_WRITE_ZERO_LOW_TIME 46 // How long we pull the bus low for sending a "0" (in software and with the one-pulse timer)
+#endif
+#ifndef ONEWIRE_PRESENCE_TIME
+#define ONEWIRE_PRESENCE_TIME 100 // How long we pull the bus low for the presence signal
+#endif
 
     /*
      * Internal Eum: you probably don't need to touch this. Ever.
@@ -38,6 +62,7 @@ extern "C"
     {
         ONEWIRE_READING_BITS,       // We are just happily reading random bits from the master
         ONEWIRE_READING_COMMAND,    // We are reading bits - but as soon as we have one byte we will try to interpret it as a certain ROM command.
+        ONEWIRE_READING_FUNCTION_COMMAND, // The ROM phase is over and we are selected. The next byte is a function command and will be dispatched via the command table.
         ONEWIRE_MATCH_ROM,          // After the master initiated the MATCH ROM procedure, we need to react accordingly -> we need to shut up and compare the ROM sent by the master
         ONEWIRE_SEARCH_ROM,         // After the master initiated the SEARCH ROM procedure, we need to react accordingly -> we need to send our ROM (quite complex algorithm)
         ONEWIRE_ALARM_SEARCH,       // Right now, this behavior is implemented exactly as SEARCH ROM because being 'alarmed' is not supported by this lib (but can be added quite easily)
@@ -54,6 +79,30 @@ extern "C"
         PIN_HIGH,                   // HIGHT -> 1-wire bus is currently high ('idle')
     } OneWire_Pin_State;
 
+    struct __OneWireSlave_HandleTypeDef;
+
+    /*
+     * Handler for a single function command (the first byte after the ROM phase).
+     * It is invoked with the command byte that triggered it, so one handler can serve several commands.
+     */
+    typedef void (*OneWire_Command_Handler)(struct __OneWireSlave_HandleTypeDef *h1ws, __uint8_t command);
+
+    /*
+     * Handler for the payload bytes following a function command (e.g. the data of a WRITE SCRATCHPAD).
+     * A command handler installs it with OneWire_Set_Byte_Handler(); it stays active until the next 'RESET'.
+     */
+    typedef void (*OneWire_Byte_Handler)(struct __OneWireSlave_HandleTypeDef *h1ws, __uint8_t byte);
+
+    /*
+     * Maps every possible function command byte to its handler. Unused entries must be 0.
+     * A table can belong to a single handle or be shared by all handles emulating the same
+     * kind of device (e.g. declare it 'static const' so it lives in flash).
+     */
+    typedef struct
+    {
+        OneWire_Command_Handler Handlers[256];
+    } OneWire_Command_Table;
+
     /*
      * Fields required for correct initilization of the OneWire slave interface!
      */
@@ -61,6 +110,8 @@ extern "C"
     {
         __uint64_t ROM_Address; // The ROM address of this device [the library doesn't care if this is meaningful; but the master might look at the family code or other data]
         __uint32_t Pin;         // This pin will be used for asking the state (HIGH or LOW) of the 1-wire bus. [If it's just one pin: PullUp, with interrupt on falling and raising edge]. You can also connect two pins to the bus (e.g. one wire sending/output and one for receiving/interrupts)
+        const OneWire_Command_Table *Command_Table; // Optional (may be 0): handlers for function commands. Commands without a handler end up in OneWire_Byte_Received_Callback.
+        void *User_Data;        // Optional: not touched by the library. Handlers can use it to find the state of their device (e.g. when the command table is shared).
     } OneWireSlave_InitTypeDef;
 
     /*
@@ -80,6 +131,7 @@ extern "C"
         __uint8_t SendDataBuffer_BitPos;
         __uint8_t ReceiveBuffer;
         __uint8_t ReceiveBuffer_BitPos;
+        OneWire_Byte_Handler Byte_Handler;
     } OneWireSlave_HandleTypeDef;
 
     /*
@@ -94,10 +146,25 @@ extern "C"
      */
     void OneWireSlave_DeInit(OneWireSlave_HandleTypeDef *h1ws);
 
+    /*
+     * Registers a handler for the given function command byte in a command table.
+     * Pass 0 as handler to remove a previously registered one. Call this before the table is
+     * assigned to a running handle (or make sure no 1-wire interrupt can happen meanwhile).
+     */
+    void OneWire_Register_Command_Handler(OneWire_Command_Table *table, __uint8_t command, OneWire_Command_Handler handler);
+
+    /*
+     * Routes the following payload bytes of the current function command to the given handler
+     * instead of OneWire_Byte_Received_Callback. Usually called from a command handler.
+     * The handler is removed on the next 'RESET' (or by passing 0).
+     */
+    void OneWire_Set_Byte_Handler(OneWireSlave_HandleTypeDef *h1ws, OneWire_Byte_Handler handler);
+
     /*
      * Implement this method to receive bytes from the master. Certain default actions regarding
-     * the ROM are handled by this library. If the command code is not known, this method will be
-     * invoked.
+     * the ROM are handled by this library. If the command code is not known and there is no
+     * handler for it in the command table of the handle, this method will be invoked. The same
+     * goes for payload bytes if no byte handler was set with @OneWire_Set_Byte_Handler.
      * Here you can act accordingly. If you do nothing, the slave will stay in reception mode.
      * If you call @OneWire_Send instead, the slave will respond to the master.
      */
@@ -141,10 +208,12 @@ extern "C"
      * In short, the following functions need to be implemented by the user of this library because
      * they are processor-specific:
      * 
+     *  - void Init_Timers(void)
      *  - void Send_Signal(__uint32_t Pin, __uint32_t duration_in_us)
      *  - void Start_Time_Meassurement(void)
      *  - __uint32_t Get_Elapsed_Time_In_Microseconds(void)
      *  - OneWire_Pin_State Get_Pin_State(__uint32_t Pin)
+     *  - void Arm_Read_Slot(__uint32_t Pin, __uint8_t bit)   [only if ONEWIRE_PREARMED_READ_SLOTS is enabled]
      * 
      * Furthermore, the following functions needs to be called by the user of this library when
      * there is an interrupts for a falling or raising edge on the 1-wire pin (e.g. the user
@@ -158,6 +227,9 @@ extern "C"
     // Note that it should also be called on interrupts observed by our own signals.
     void OneWire_Interrupt_Callback(OneWireSlave_HandleTypeDef *h1ws, OneWire_Pin_State pin_state);
 
+    // Sets up the timers needed by the functions below. Called by OneWireSlave_Init().
+    void Init_Timers(void);
+
     // This function should pull our 1-wire pin low for a given duration in microseconds.
     // Whether this function is implemented synchronously or asynchronously is up to you,
     // but note that the rest of this library is implemented async.
@@ -175,6 +247,15 @@ extern "C"
     // Returns the state of the given pin.
     OneWire_Pin_State Get_Pin_State(__uint32_t Pin);
 
+    // Only needed if ONEWIRE_PREARMED_READ_SLOTS is enabled.
+    // Pre-loads our answer to the next read slot. If 'bit' is 0, the next falling edge on the bus
+    // has to pull our pin low in hardware (e.g. a timer in one-pulse mode that is triggered by the pin)
+    // for ONEWIRE_WRITE_ZERO_LOW_TIME microseconds. Otherwise ("1"), the pin must stay released on
+    // the next falling edge - this is also how a pending answer is cancelled.
+    // The library calls this right after the previous slot, so it must not take longer than the
+    // recovery time of the master.
+    void Arm_Read_Slot(__uint32_t Pin, __uint8_t bit);
+
 
 #ifdef __cplusplus
 }
@@ -0,0 +1,555 @@
+#ifndef __ONE_WIRE_SLAVE_HPP__
+#define __ONE_WIRE_SLAVE_HPP__
+
+/*
+ * Header-only C++ front-end of this library (C++17).
+ *
+ * This is a separate implementation of the link and ROM layer state machines of onewire-slave.c
+ * (same states, same transitions), written so that everything that is fixed for a device is a
+ * compile-time parameter instead of a field in the handle: ROM address, timing, the bus backend
+ * and the callbacks. For single-device builds the compiler can fold all of these and inline the
+ * whole path from the interrupt to the callbacks.
+ *
+ * The two implementations are not generated from common code, so a change to one of them has to
+ * be made in the other one as well. test/compare-test.cpp runs both through every ROM command
+ * path (SEARCH ROM, CONDITIONAL SEARCH ROM, READ ROM, MATCH ROM, SKIP ROM, no ROM command) on the
+ * simulated bus and fails if they answer differently ('make -C test bench' compares their speed).
+ *
+ * Intended differences to the C library:
+ *  - Function commands go to Handlers::Function_Command() instead of an OneWire_Command_Table.
+ *  - Payload bytes always go to Handlers::Byte_Received(); there is no OneWire_Set_Byte_Handler().
+ *    The handlers object keeps track of the current command itself.
+ *  - There is no User_Data: the state of the device lives in the handlers object (Get_Handlers()).
+ *  - The bits sent during SEARCH ROM come from a table computed at compile time from the ROM
+ *    address (instead of masking the ROM address at runtime).
+ *  - Timing comes from Config::Timing (the defaults are the ONEWIRE_*_TIME macros).
+ *  - There is no global instance list and there are no weak symbols: call Init() once and then
+ *    Interrupt_Callback() of your slave object directly from the interrupt handler of its pin.
+ *
+ * With C_Bus, the platform functions of onewire-slave.c are used (Init_Timers(), Send_Signal(), ...),
+ * so that file needs to be linked. Compile it with ONEWIRE_CUSTOM_EXTI_CALLBACK, so it doesn't
+ * define the EXTI handler of the C front-end, and with ONEWIRE_PREARMED_READ_SLOTS=1 if the
+ * configuration uses pre-armed read slots.
+ *
+ * Example:
+ *
+ *  struct Thermometer_Handlers : onewire::No_Handlers
+ *  {
+ *      template <class Slave> void Function_Command(Slave &slave, uint8_t command)
+ *      {
+ *          switch (command)
+ *          {
+ *          case 0xBE: slave.Send(scratchpad, 9); break;
+ *          ...
+ *          }
+ *      }
+ *      uint8_t scratchpad[9];
+ *  };
+ *
+ *  struct Thermometer_Config
+ *  {
+ *      static constexpr uint64_t ROM_Address = onewire::Rom<0x28, 0x0000000ABCDE>::Address;
+ *      static constexpr bool Prearmed_Read_Slots = false;
+ *      using Timing = onewire::Default_Timing;
+ *      using Bus = onewire::C_Bus<OneWireInput_Pin>;
+ *      using Handlers = Thermometer_Handlers;
+ *  };
+ *
+ *  onewire::OneWireSlave<Thermometer_Config> thermometer;
+ *
+ *  void HAL_GPIO_EXTI_Callback(uint16_t GPIO_Pin)
+ *  {
+ *      thermometer.Interrupt_Callback(HAL_GPIO_ReadPin(GPIOB, GPIO_Pin) ? PIN_HIGH : PIN_LOW);
+ *  }
+ *
+ *  int main()
+ *  {
+ *      ...
+ *      thermometer.Init();
+ *  }
+ */
+
+#include <stdint.h>
+#include "onewire-slave.h" // for OneWire_LowLevel_State, OneWire_ROM_State and OneWire_Pin_State
+
+namespace onewire
+{
+
+    /*
+     * CRC8 (Dallas/Maxim, x^8 + x^5 + x^4 + 1) of the lowest 'bytes' bytes of 'data', LSB first.
+     * References:
+     *  - https://www.maximintegrated.com/en/app-notes/index.mvp/id/27
+     */
+    constexpr uint8_t Crc8(uint64_t data, int bytes)
+    {
+        uint8_t crc = 0;
+        for (int i = 0; i < bytes * 8; i++)
+        {
+            uint8_t mix = (crc ^ (uint8_t)(data >> i)) & 0x01;
+            crc >>= 1;
+            if (mix)
+            {
+                crc ^= 0x8C;
+            }
+        }
+        return crc;
+    }
+
+    /*
+     * Builds a complete ROM address (family code + serial number + CRC) at compile time.
+     * The layout is the same as in OneWireSlave_InitTypeDef::ROM_Address: family code in the
+     * lowest byte, CRC in the highest byte.
+     */
+    template <uint8_t Family_Code, uint64_t Serial_Number>
+    struct Rom
+    {
+        static_assert(Serial_Number < ((uint64_t)1 << 48), "the serial number has only 48 bits");
+
+        static constexpr uint64_t Without_Crc = (uint64_t)Family_Code | (Serial_Number << 8);
+        static constexpr uint64_t Address = Without_Crc | ((uint64_t)Crc8(Without_Crc, 7) << 56);
+    };
+
+    /*
+     * Timing thresholds in microseconds: the same values onewire-slave.c uses (see onewire-slave.h).
+     * Provide your own struct with the same members for other speeds. Note that with C_Bus and
+     * pre-armed read slots, the length of a "0" is fixed to ONEWIRE_WRITE_ZERO_LOW_TIME by the timer.
+     */
+    struct Default_Timing
+    {
+        static constexpr uint32_t Write_One_Max = ONEWIRE_WRITE_ONE_MAX_TIME;
+        static constexpr uint32_t Bit_Max = ONEWIRE_BIT_MAX_TIME;
+        static constexpr uint32_t Reset_While_Writing = ONEWIRE_RESET_WHILE_WRITING_TIME;
+        static constexpr uint32_t Write_Zero_Low = ONEWIRE_WRITE_ZERO_LOW_TIME;
+        static constexpr uint32_t Presence_Low = ONEWIRE_PRESENCE_TIME;
+    };
+
+    /*
+     * Bus backend that forwards to the platform functions of the C library (see onewire-slave.h),
+     * so existing implementations (e.g. the STM32 one or onewire-slave-sim.c) can be reused.
+     * A custom backend needs the same static functions. Init() is called by OneWireSlave::Init().
+     */
+    template <uint32_t Pin>
+    struct C_Bus
+    {
+        static inline void Init() { ::Init_Timers(); }
+        static inline void Send_Signal(uint32_t duration_in_us) { ::Send_Signal(Pin, duration_in_us); }
+        static inline void Start_Time_Meassurement() { ::Start_Time_Meassurement(); }
+        static inline uint32_t Get_Elapsed_Time_In_Microseconds() { return ::Get_Elapsed_Time_In_Microseconds(); }
+        static inline void Arm_Read_Slot(uint8_t bit) // only used with Prearmed_Read_Slots
+        {
+            static_assert(Pin == Pin && ONEWIRE_PREARMED_READ_SLOTS, "pre-armed read slots need ONEWIRE_PREARMED_READ_SLOTS=1 (also for onewire-slave.c)");
+            ::Arm_Read_Slot(Pin, bit);
+        }
+    };
+
+    /*
+     * Default callbacks: they do nothing, like the weak callbacks of the C library.
+     * Derive from this struct and only define the callbacks you need.
+     * Function commands (the first byte after the ROM phase) go to Function_Command(); the
+     * default forwards them to Byte_Received() like the C library does without a command table.
+     */
+    struct No_Handlers
+    {
+        template <class Slave>
+        void Byte_Received(Slave &slave, uint8_t byte)
+        {
+            (void)slave;
+            (void)byte;
+        }
+
+        template <class Slave>
+        void Bit_Received(Slave &slave, uint8_t bit)
+        {
+            (void)slave;
+            (void)bit;
+        }
+
+        template <class Slave>
+        void Reset_Received(Slave &slave)
+        {
+            (void)slave;
+        }
+
+        template <class Slave>
+        void Function_Command(Slave &slave, uint8_t command)
+        {
+            slave.Get_Handlers().Byte_Received(slave, command);
+        }
+    };
+
+    /*
+     * A OneWire slave with a compile-time configuration. 'Config' needs these members:
+     *
+     *  - static constexpr uint64_t ROM_Address;       // e.g. Rom<...>::Address
+     *  - static constexpr bool Prearmed_Read_Slots;   // see ONEWIRE_PREARMED_READ_SLOTS
+     *  - using Timing = ...;                          // e.g. Default_Timing
+     *  - using Bus = ...;                             // e.g. C_Bus<Pin>
+     *  - using Handlers = ...;                        // derived from No_Handlers
+     */
+    template <class Config>
+    class OneWireSlave
+    {
+    public:
+        using Timing = typename Config::Timing;
+        using Bus = typename Config::Bus;
+        using Handlers = typename Config::Handlers;
+
+        static constexpr uint64_t ROM_Address = Config::ROM_Address;
+
+        OneWireSlave() = default;
+        explicit OneWireSlave(const Handlers &handlers) : handlers(handlers) {}
+
+        Handlers &Get_Handlers() { return handlers; }
+
+        /*
+         * Same as OneWireSlave_Init(): sets up the bus backend and the initial state.
+         */
+        inline void Init()
+        {
+            Bus::Init();
+            LL_State = ONEWIRE_R_IDLE;
+            ROM_State = ONEWIRE_WAIT; // until the first 'RESET'
+        }
+
+        /*
+         * Same as OneWire_Send(): the slave will respond with the message when the master asks for it.
+         * The message must stay valid until it has been sent.
+         */
+        inline void Send(const uint8_t *message, uint16_t message_length)
+        {
+            SendDataBuffer = message;
+            SendDataBuffer_Length = message_length;
+            SendDataBuffer_Pos = 0;
+            SendDataBuffer_BitPos = 0x01;
+            Start_Writing();
+        }
+
+        /*
+         * Same as OneWire_SendBit().
+         */
+        inline void Send_Bit(uint8_t bit)
+        {
+            Internal_Buffer[0] = (bit) ? 0x80 : 0x00;
+            SendDataBuffer = Internal_Buffer;
+            SendDataBuffer_Length = 1;
+            SendDataBuffer_Pos = 0;
+            SendDataBuffer_BitPos = 0x80;
+            Start_Writing();
+        }
+
+        /*
+         * Same as OneWire_Interrupt_Callback() / Process_Communation_Protocol(): call this when there
+         * is a falling OR a raising edge on the 1-wire pin (also for edges caused by our own signals).
+         */
+        inline void Interrupt_Callback(OneWire_Pin_State pin_state)
+        {
+            switch (LL_State)
+            {
+            case ONEWIRE_R_IDLE:
+                if (pin_state == PIN_LOW) // Master initiates communication
+                {
+                    // save timestamp of message initiation
+                    Bus::Start_Time_Meassurement();
+                    LL_State = ONEWIRE_MASTER_SENDS_DATA;
+                }
+                break;
+            case ONEWIRE_MASTER_SENDS_DATA:
+                if (pin_state == PIN_HIGH) // Master finished transmitting signal
+                {
+                    uint32_t time_elapsed = Bus::Get_Elapsed_Time_In_Microseconds();
+
+                    if (time_elapsed <= Timing::Bit_Max) // Master sent a bit
+                    {
+                        LL_State = ONEWIRE_R_IDLE;
+                        Process_Received_Bit((time_elapsed < Timing::Write_One_Max) ? 1 : 0);
+                        break;
+                    }
+                    // else: master sent a RESET signal -> go to next state immediatelly
+                }
+                [[fallthrough]];
+            case ONEWIRE_RESET:
+            goto_reset_state:
+                if (pin_state == PIN_HIGH) // Reset signal by master is over. We now need to send our presence signal.
+                {
+                    // send presence signal so master knows there are devices
+                    Bus::Send_Signal(Timing::Presence_Low);
+
+                    Process_Reset_Signal();
+
+                    LL_State = ONEWIRE_SENDING_PRESENCE;
+                }
+                break;
+            case ONEWIRE_SENDING_PRESENCE:
+                if (pin_state == PIN_HIGH) // our own presence signal is over
+                {
+                    LL_State = ONEWIRE_R_IDLE;
+                }
+                break;
+            case ONEWIRE_W_IDLE:
+                if (pin_state == PIN_LOW) // Master requests data
+                {
+                    Bus::Start_Time_Meassurement();
+                    if constexpr (!Config::Prearmed_Read_Slots)
+                    {
+                        if (!Get_Current_Bit_To_Send()) // Send a "0" ("1" is implicit)
+                        {
+                            Bus::Send_Signal(Timing::Write_Zero_Low);
+                        }
+                    }
+                    // else: the bit has already been sent by the hardware when the master pulled the bus low
+                    LL_State = ONEWIRE_WRITING;
+                }
+                break;
+            case ONEWIRE_WRITING:
+                if (pin_state == PIN_HIGH)
+                {
+                    if (Bus::Get_Elapsed_Time_In_Microseconds() > Timing::Reset_While_Writing)
+                    { // we trapped into a reset signal
+                        if constexpr (Config::Prearmed_Read_Slots)
+                        {
+                            Bus::Arm_Read_Slot(1);
+                        }
+                        goto goto_reset_state;
+                    }
+
+                    if (Advance_To_Next_Bit_In_Buffer())
+                    {
+                        LL_State = ONEWIRE_W_IDLE;
+                        if constexpr (Config::Prearmed_Read_Slots)
+                        {
+                            // re-arm for the next slot - this has to happen before the master's next falling edge
+                            Bus::Arm_Read_Slot(Get_Current_Bit_To_Send());
+                        }
+                    }
+                    else
+                    {
+                        LL_State = ONEWIRE_R_IDLE;
+                        if constexpr (Config::Prearmed_Read_Slots)
+                        {
+                            Bus::Arm_Read_Slot(1);
+                        }
+                    }
+                }
+                break;
+            }
+        }
+
+    private:
+        // Byte sent for ROM bit i during SEARCH ROM: the bit followed by its complement (0x40 = "1" then "0").
+        // Its 0x40 bit is also the ROM bit MATCH ROM compares with.
+        struct Search_Schedule_Table
+        {
+            uint8_t Bits[64];
+
+            constexpr Search_Schedule_Table() : Bits()
+            {
+                for (int i = 0; i < 64; i++)
+                {
+                    Bits[i] = ((ROM_Address >> i) & 1) ? 0x40 : 0x80;
+                }
+            }
+        };
+        static constexpr Search_Schedule_Table Search_Schedule = Search_Schedule_Table();
+
+        // The ROM in the order it is sent on READ ROM (family code first)
+        static constexpr uint8_t ROM_Bytes[8] = {
+            (uint8_t)(ROM_Address >> 0), (uint8_t)(ROM_Address >> 8), (uint8_t)(ROM_Address >> 16), (uint8_t)(ROM_Address >> 24),
+            (uint8_t)(ROM_Address >> 32), (uint8_t)(ROM_Address >> 40), (uint8_t)(ROM_Address >> 48), (uint8_t)(ROM_Address >> 56),
+        };
+
+        Handlers handlers;
+        OneWire_LowLevel_State LL_State = ONEWIRE_R_IDLE;
+        OneWire_ROM_State ROM_State = ONEWIRE_WAIT;
+        uint8_t Internal_Buffer[1] = {0};
+        uint8_t ROM_Bit = 0; // index into Search_Schedule (replaces ROM_Mask of the C handle)
+        const uint8_t *SendDataBuffer = Internal_Buffer;
+        uint16_t SendDataBuffer_Length = 0;
+        uint16_t SendDataBuffer_Pos = 0;
+        uint8_t SendDataBuffer_BitPos = 0x01;
+        uint8_t ReceiveBuffer = 0;
+        uint8_t ReceiveBuffer_BitPos = 0x01;
+
+        //************************************
+        //            NETWORK LAYER
+        //    ROM / HIGH LEVEL STATE MACHINE
+        //************************************
+
+        inline void Start_Writing()
+        {
+            LL_State = ONEWIRE_W_IDLE;
+            if constexpr (Config::Prearmed_Read_Slots)
+            {
+                Bus::Arm_Read_Slot(Get_Current_Bit_To_Send());
+            }
+        }
+
+        // write the current ROM bit and its complement to the bus
+        inline void Send_Search_Bits()
+        {
+            Internal_Buffer[0] = Search_Schedule.Bits[ROM_Bit];
+            SendDataBuffer = Internal_Buffer;
+            SendDataBuffer_Length = 1;
+            SendDataBuffer_Pos = 0;
+            SendDataBuffer_BitPos = 0x40;
+            Start_Writing();
+        }
+
+        inline void Received_Command()
+        {
+            switch (ReceiveBuffer)
+            {
+            case 0xF0: // SEARCH ROM
+                ROM_Bit = 0; // Begin with LSB
+                Send_Search_Bits();
+                ROM_State = ONEWIRE_SEARCH_ROM;
+                break;
+            case 0xEC: // CONDITIONAL SEARCH ROM
+                ROM_Bit = 0; // Begin with LSB
+                Send_Search_Bits();
+                ROM_State = ONEWIRE_ALARM_SEARCH;
+                break;
+            case 0x33: // READ ROM
+                Send(ROM_Bytes, 8);
+                ROM_State = ONEWIRE_READING_FUNCTION_COMMAND;
+                break;
+            case 0x55: // MATCH ROM
+                ROM_Bit = 0; // Begin with LSB
+                ROM_State = ONEWIRE_MATCH_ROM;
+                break;
+            case 0xCC: // SKIP ROM
+                ROM_State = ONEWIRE_READING_FUNCTION_COMMAND;
+                break;
+            default: // not a ROM command -> treat it as function command
+                handlers.Function_Command(*this, ReceiveBuffer);
+                break;
+            }
+        }
+
+        // Stores the bit in the receive buffer. Returns true, if the buffer is full.
+        inline bool Receive_Bit(uint8_t bit)
+        {
+            ReceiveBuffer |= (ReceiveBuffer_BitPos & ((bit) ? 0xFF : 0x00));
+            ReceiveBuffer_BitPos = ReceiveBuffer_BitPos << 1; // LSB byte order!
+            return !ReceiveBuffer_BitPos;
+        }
+
+        inline void Clear_Receive_Buffer()
+        {
+            ReceiveBuffer = 0;
+            ReceiveBuffer_BitPos = 0x01; // data is sent LSB first in 1-wire
+        }
+
+        inline void Process_Received_Bit(uint8_t bit)
+        {
+            switch (ROM_State)
+            {
+            case ONEWIRE_READING_COMMAND: // Read commands (first byte after reset)
+                if (Receive_Bit(bit))
+                {
+                    ROM_State = ONEWIRE_READING_BITS;
+                    Received_Command();
+                    Clear_Receive_Buffer();
+                }
+                break;
+            case ONEWIRE_READING_FUNCTION_COMMAND: // Read function command (first byte after ROM phase)
+                if (Receive_Bit(bit))
+                {
+                    ROM_State = ONEWIRE_READING_BITS;
+                    handlers.Function_Command(*this, ReceiveBuffer);
+                    Clear_Receive_Buffer();
+                }
+                break;
+            case ONEWIRE_READING_BITS: // Read payload data
+                if (Receive_Bit(bit))
+                {
+                    ROM_State = ONEWIRE_READING_BITS;
+                    handlers.Byte_Received(*this, ReceiveBuffer);
+                    Clear_Receive_Buffer();
+                }
+                break;
+            case ONEWIRE_MATCH_ROM:
+                if (!bit == !(Search_Schedule.Bits[ROM_Bit] & 0x40)) // bit and ROM bit do match
+                {
+                    if (++ROM_Bit == 64) // whole ROM has been compared
+                    {
+                        // We are selected -> listen for the function command
+                        ROM_State = ONEWIRE_READING_FUNCTION_COMMAND;
+                    }
+                }
+                else
+                {
+                    ROM_State = ONEWIRE_WAIT; // means: match failed -> slave should shut up until next reset
+                }
+                break;
+            case ONEWIRE_ALARM_SEARCH: // we assume we are never alarmed
+            case ONEWIRE_SEARCH_ROM:
+                if (!bit == !(Search_Schedule.Bits[ROM_Bit] & 0x40)) // bits do match
+                {
+                    if (++ROM_Bit == 64) // whole ROM has been compared
+                    {
+                        // The master found us and we are selected (like after MATCH ROM) -> listen for the function command
+                        ROM_State = ONEWIRE_READING_FUNCTION_COMMAND;
+                    }
+                    else
+                    {
+                        Send_Search_Bits();
+                    }
+                }
+                else
+                {
+                    ROM_State = ONEWIRE_WAIT; // means: match failed -> slave should shut up until next reset
+                }
+                break;
+            case ONEWIRE_WAIT: // wait until next reset
+                break;
+            }
+
+            handlers.Bit_Received(*this, bit);
+        }
+
+        inline void Process_Reset_Signal()
+        {
+            ROM_State = ONEWIRE_READING_COMMAND;
+
+            // reset everything
+            Clear_Receive_Buffer();
+            SendDataBuffer_Pos = 0;
+            SendDataBuffer_BitPos = 0x01;
+            SendDataBuffer_Length = 0;
+
+            handlers.Reset_Received(*this);
+        }
+
+        //************************************
+        //          LINK LAYER
+        //************************************
+
+        // Returns the next bit to be sent
+        inline uint8_t Get_Current_Bit_To_Send() const
+        {
+            return SendDataBuffer[SendDataBuffer_Pos] & SendDataBuffer_BitPos;
+        }
+
+        // Returns true, if there are still bits that need to be sent.
+        inline bool Advance_To_Next_Bit_In_Buffer()
+        {
+            SendDataBuffer_BitPos = SendDataBuffer_BitPos << 1; // LSB byte order!
+            if (!SendDataBuffer_BitPos)                         // we need to go to the next byte
+            {
+                if (SendDataBuffer_Pos + 1 < SendDataBuffer_Length)
+                {
+                    SendDataBuffer_Pos++;
+                    SendDataBuffer_BitPos = 0x01; // data is sent LSB first in 1-wire
+                }
+                else
+                {
+                    return false; // done sending
+                }
+            }
+            return true; // still more bits in the buffer
+        }
+    };
+
+} // namespace onewire
+
+#endif /* __ONE_WIRE_SLAVE_HPP__ */
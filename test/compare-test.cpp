@@ -0,0 +1,409 @@
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <vector>
+#include "onewire-slave.hpp"
+#include "onewire-slave-sim.h"
+
+// Host test: runs the C library and the C++ front-end through the same sequence on the
+// simulated bus and compares what the master reads.
+// With --bench (make bench), it compares the speed of both front-ends instead.
+// Built once per mode (ONEWIRE_PREARMED_READ_SLOTS=0/1), see Makefile.
+
+static int failures = 0;
+
+#define CHECK(condition)                                                    \
+    do                                                                      \
+    {                                                                       \
+        if (!(condition))                                                   \
+        {                                                                   \
+            printf("%s:%d: check failed: %s\n", __FILE__, __LINE__, #condition); \
+            failures++;                                                     \
+        }                                                                   \
+    } while (0)
+
+static constexpr uint64_t ROM_Address = onewire::Rom<0x28, 0x00000ABCDE66>::Address;
+static const uint8_t Initial_Scratchpad[9] = {0x50, 0x05, 0x4B, 0x46, 0x7F, 0xFF, 0x0C, 0x10, 0x1C};
+
+// State of the emulated thermometer. WRITE SCRATCHPAD (0x4E) writes the bytes 2..4.
+struct Device
+{
+    uint8_t Scratchpad[9];
+    uint8_t Write_Pos;
+    bool Writing;
+
+    void Reset()
+    {
+        memcpy(Scratchpad, Initial_Scratchpad, sizeof(Scratchpad));
+        Write_Pos = 0;
+        Writing = false;
+    }
+
+    void Write_Byte(uint8_t byte)
+    {
+        if (Writing && Write_Pos < 3)
+        {
+            Scratchpad[2 + Write_Pos++] = byte;
+        }
+    }
+};
+
+//************************************
+//        C LIBRARY DEVICE
+//************************************
+
+static Device C_Device;
+static OneWire_Command_Table C_Commands;
+static OneWireSlave_HandleTypeDef C_Slave;
+
+static void C_Read_Scratchpad(OneWireSlave_HandleTypeDef *h1ws, uint8_t command)
+{
+    (void)command;
+    OneWire_Send(h1ws, ((Device *)h1ws->Init.User_Data)->Scratchpad, 9);
+}
+
+static void C_Write_Scratchpad_Byte(OneWireSlave_HandleTypeDef *h1ws, uint8_t byte)
+{
+    ((Device *)h1ws->Init.User_Data)->Write_Byte(byte);
+}
+
+static void C_Write_Scratchpad(OneWireSlave_HandleTypeDef *h1ws, uint8_t command)
+{
+    (void)command;
+    Device *device = (Device *)h1ws->Init.User_Data;
+    device->Write_Pos = 0;
+    device->Writing = true;
+    OneWire_Set_Byte_Handler(h1ws, C_Write_Scratchpad_Byte);
+}
+
+//************************************
+//        C++ FRONT-END DEVICE
+//************************************
+
+struct Cpp_Handlers : onewire::No_Handlers
+{
+    Device device;
+
+    template <class Slave>
+    void Function_Command(Slave &slave, uint8_t command)
+    {
+        switch (command)
+        {
+        case 0xBE: // READ SCRATCHPAD
+            slave.Send(device.Scratchpad, 9);
+            break;
+        case 0x4E: // WRITE SCRATCHPAD
+            device.Write_Pos = 0;
+            device.Writing = true;
+            break;
+        default:
+            onewire::No_Handlers::Function_Command(slave, command);
+            break;
+        }
+    }
+
+    template <class Slave>
+    void Byte_Received(Slave &slave, uint8_t byte)
+    {
+        (void)slave;
+        device.Write_Byte(byte);
+    }
+
+    template <class Slave>
+    void Reset_Received(Slave &slave)
+    {
+        (void)slave;
+        device.Writing = false;
+    }
+};
+
+struct Cpp_Config
+{
+    static constexpr uint64_t ROM_Address = ::ROM_Address;
+    static constexpr bool Prearmed_Read_Slots = ONEWIRE_PREARMED_READ_SLOTS;
+    using Timing = onewire::Default_Timing;
+    using Bus = onewire::C_Bus<1>;
+    using Handlers = Cpp_Handlers;
+};
+
+static onewire::OneWireSlave<Cpp_Config> Cpp_Slave;
+
+//************************************
+//        EDGE HANDLERS
+//************************************
+
+static uint64_t Edges;
+
+static void C_Edge(void *slave, OneWire_Pin_State pin_state)
+{
+    OneWire_Interrupt_Callback((OneWireSlave_HandleTypeDef *)slave, pin_state);
+    Edges++;
+}
+
+static void Cpp_Edge(void *slave, OneWire_Pin_State pin_state)
+{
+    ((onewire::OneWireSlave<Cpp_Config> *)slave)->Interrupt_Callback(pin_state);
+    Edges++;
+}
+
+//************************************
+//        TEST SEQUENCE
+//************************************
+
+static void Start(bool cpp)
+{
+    OneWireSim_Init(&OneWireSim_Standard_Timing);
+    if (cpp)
+    {
+        Cpp_Slave.Get_Handlers().device.Reset();
+        Cpp_Slave.Init();
+        OneWireSim_Attach(Cpp_Edge, &Cpp_Slave);
+    }
+    else
+    {
+        C_Device.Reset();
+        OneWireSlave_DeInit(&C_Slave);
+        OneWireSlave_Init(&C_Slave);
+        OneWireSim_Attach(C_Edge, &C_Slave);
+    }
+}
+
+static void Read_Bytes(std::vector<uint8_t> &transcript, int count)
+{
+    for (int i = 0; i < count; i++)
+    {
+        transcript.push_back(OneWireSim_Master_Read_Byte());
+    }
+}
+
+static void Match_Rom(uint64_t rom)
+{
+    OneWireSim_Master_Write_Byte(0x55);
+    for (int i = 0; i < 8; i++)
+    {
+        OneWireSim_Master_Write_Byte((uint8_t)(rom >> (i * 8)));
+    }
+}
+
+// The master walks the first 'bits' bits of the search tree along our ROM
+static void Search_Rom(std::vector<uint8_t> &transcript, int bits)
+{
+    for (int i = 0; i < bits; i++)
+    {
+        uint8_t bit = OneWireSim_Master_Read_Bit();
+        uint8_t complement = OneWireSim_Master_Read_Bit();
+        transcript.push_back(bit);
+        transcript.push_back(complement);
+        OneWireSim_Master_Write_Bit(bit);
+    }
+}
+
+static void Expect_Search_Rom(std::vector<uint8_t> &expected, int bits)
+{
+    for (int i = 0; i < bits; i++)
+    {
+        expected.push_back((ROM_Address >> i) & 1);
+        expected.push_back(!((ROM_Address >> i) & 1));
+    }
+}
+
+// Everything the master reads (presence, bytes, SEARCH ROM bits) in order.
+// It goes through every ROM command path of the state machine.
+static std::vector<uint8_t> Run_Sequence()
+{
+    std::vector<uint8_t> transcript;
+
+    // SKIP ROM + READ SCRATCHPAD
+    transcript.push_back(OneWireSim_Master_Reset());
+    OneWireSim_Master_Write_Byte(0xCC);
+    OneWireSim_Master_Write_Byte(0xBE);
+    Read_Bytes(transcript, 9);
+
+    // MATCH ROM + WRITE SCRATCHPAD (with 3 bytes of payload)
+    transcript.push_back(OneWireSim_Master_Reset());
+    Match_Rom(ROM_Address);
+    OneWireSim_Master_Write_Byte(0x4E);
+    OneWireSim_Master_Write_Byte(0x11);
+    OneWireSim_Master_Write_Byte(0x22);
+    OneWireSim_Master_Write_Byte(0x33);
+
+    // MATCH ROM + READ SCRATCHPAD
+    transcript.push_back(OneWireSim_Master_Reset());
+    Match_Rom(ROM_Address);
+    OneWireSim_Master_Write_Byte(0xBE);
+    Read_Bytes(transcript, 9);
+
+    // MATCH ROM with another ROM -> we need to stay quiet
+    transcript.push_back(OneWireSim_Master_Reset());
+    Match_Rom(ROM_Address ^ 0x0100);
+    OneWireSim_Master_Write_Byte(0xBE);
+    Read_Bytes(transcript, 2);
+
+    // READ ROM
+    transcript.push_back(OneWireSim_Master_Reset());
+    OneWireSim_Master_Write_Byte(0x33);
+    Read_Bytes(transcript, 8);
+
+    // SEARCH ROM + READ SCRATCHPAD
+    transcript.push_back(OneWireSim_Master_Reset());
+    OneWireSim_Master_Write_Byte(0xF0);
+    Search_Rom(transcript, 64);
+    // we are selected now -> READ SCRATCHPAD has to be answered
+    OneWireSim_Master_Write_Byte(0xBE);
+    Read_Bytes(transcript, 9);
+
+    // CONDITIONAL SEARCH ROM (handled like SEARCH ROM) + READ SCRATCHPAD
+    transcript.push_back(OneWireSim_Master_Reset());
+    OneWireSim_Master_Write_Byte(0xEC);
+    Search_Rom(transcript, 64);
+    OneWireSim_Master_Write_Byte(0xBE);
+    Read_Bytes(transcript, 9);
+
+    // SEARCH ROM where the master takes the other branch at bit 5 -> we need to stay quiet
+    transcript.push_back(OneWireSim_Master_Reset());
+    OneWireSim_Master_Write_Byte(0xF0);
+    Search_Rom(transcript, 5);
+    transcript.push_back(OneWireSim_Master_Read_Bit());
+    transcript.push_back(OneWireSim_Master_Read_Bit());
+    OneWireSim_Master_Write_Bit(!((ROM_Address >> 5) & 1));
+    transcript.push_back(OneWireSim_Master_Read_Bit());
+    transcript.push_back(OneWireSim_Master_Read_Bit());
+    OneWireSim_Master_Write_Byte(0xBE);
+    Read_Bytes(transcript, 2);
+
+    // no ROM command: the first byte is taken as function command
+    transcript.push_back(OneWireSim_Master_Reset());
+    OneWireSim_Master_Write_Byte(0xBE);
+    Read_Bytes(transcript, 9);
+
+    return transcript;
+}
+
+static std::vector<uint8_t> Expected_Transcript()
+{
+    std::vector<uint8_t> expected;
+
+    expected.push_back(1);
+    expected.insert(expected.end(), Initial_Scratchpad, Initial_Scratchpad + 9);
+    expected.push_back(1);
+    expected.push_back(1);
+    uint8_t written[9];
+    memcpy(written, Initial_Scratchpad, 9);
+    written[2] = 0x11;
+    written[3] = 0x22;
+    written[4] = 0x33;
+    expected.insert(expected.end(), written, written + 9);
+    expected.push_back(1);
+    expected.push_back(0xFF);
+    expected.push_back(0xFF);
+    expected.push_back(1);
+    for (int i = 0; i < 8; i++)
+    {
+        expected.push_back((uint8_t)(ROM_Address >> (i * 8)));
+    }
+    expected.push_back(1);
+    Expect_Search_Rom(expected, 64);
+    expected.insert(expected.end(), written, written + 9);
+    expected.push_back(1);
+    Expect_Search_Rom(expected, 64);
+    expected.insert(expected.end(), written, written + 9);
+    expected.push_back(1);
+    Expect_Search_Rom(expected, 6);
+    expected.push_back(1); // nobody answers the next search bits...
+    expected.push_back(1);
+    expected.push_back(0xFF); // ... nor the function command
+    expected.push_back(0xFF);
+    expected.push_back(1);
+    expected.insert(expected.end(), written, written + 9);
+
+    return expected;
+}
+
+static uint64_t Now_In_Nanoseconds()
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000000 + (uint64_t)now.tv_nsec;
+}
+
+// Runs the whole sequence many times with one clock reading before and after each batch and
+// returns the best time per sequence in nanoseconds. The simulated bus does exactly the same work
+// for both front-ends (their transcripts are equal), so the difference is the cost of the edge handler.
+static double Time_Sequence(bool cpp)
+{
+    const int Batches = 50, Sequences_Per_Batch = 20;
+    double best = 0;
+    for (int batch = 0; batch < Batches; batch++)
+    {
+        uint64_t start = Now_In_Nanoseconds();
+        for (int i = 0; i < Sequences_Per_Batch; i++)
+        {
+            Start(cpp);
+            Run_Sequence();
+        }
+        double duration = (double)(Now_In_Nanoseconds() - start) / Sequences_Per_Batch;
+        if (batch == 0 || duration < best)
+        {
+            best = duration;
+        }
+    }
+    return best;
+}
+
+static int Bench()
+{
+    double c_best = 0, cpp_best = 0;
+    for (int round = 0; round < 5; round++) // in turns, so both see the same state of the machine
+    {
+        double c = Time_Sequence(false);
+        double cpp = Time_Sequence(true);
+        if (round == 0 || c < c_best)
+        {
+            c_best = c;
+        }
+        if (round == 0 || cpp < cpp_best)
+        {
+            cpp_best = cpp;
+        }
+    }
+    Edges = 0;
+    Start(false);
+    Run_Sequence();
+    printf("sequence incl. simulated bus (%s read slots, %llu edges): C %.0f ns, C++ %.0f ns (C++/C = %.2f)\n",
+           (ONEWIRE_PREARMED_READ_SLOTS) ? "pre-armed" : "software", (unsigned long long)Edges,
+           c_best, cpp_best, cpp_best / c_best);
+    // only a large regression counts, small differences are within the noise of the machine
+    CHECK(cpp_best <= c_best * 1.5);
+    return (failures) ? 1 : 0;
+}
+
+int main(int argc, char **argv)
+{
+    OneWire_Register_Command_Handler(&C_Commands, 0xBE, C_Read_Scratchpad);
+    OneWire_Register_Command_Handler(&C_Commands, 0x4E, C_Write_Scratchpad);
+    C_Slave.Init.ROM_Address = ROM_Address;
+    C_Slave.Init.Pin = 1;
+    C_Slave.Init.Command_Table = &C_Commands;
+    C_Slave.Init.User_Data = &C_Device;
+
+    if (argc > 1 && strcmp(argv[1], "--bench") == 0)
+    {
+        return Bench();
+    }
+
+    CHECK(onewire::Crc8(ROM_Address, 8) == 0);
+
+    Start(false);
+    std::vector<uint8_t> c_transcript = Run_Sequence();
+    Start(true);
+    std::vector<uint8_t> cpp_transcript = Run_Sequence();
+    std::vector<uint8_t> expected = Expected_Transcript();
+
+    CHECK(c_transcript == expected);
+    CHECK(cpp_transcript == expected);
+    CHECK(OneWireSim_Get_Stats()->Missed_Deadlines == 0);
+
+    printf("%s read slots: C and C++ transcripts %s\n", (ONEWIRE_PREARMED_READ_SLOTS) ? "pre-armed" : "software",
+           (failures) ? "differ" : "match");
+    return (failures) ? 1 : 0;
+}
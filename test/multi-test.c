@@ -0,0 +1,183 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include "onewire-slave-sim.h"
+
+// Host test for several handles in one program (built with MAX_ONEWIRE_INSTANCES=3, see Makefile):
+//  - a thermometer with its own command table
+//  - two memory devices that share one 'static const' command table and keep their
+//    contents in User_Data
+// Every device gets its own simulated bus (= pin). The edges are dispatched through the global
+// instance list, just like HAL_GPIO_EXTI_Callback() does on the STM32.
+
+static int failures = 0;
+
+#define CHECK(condition)                                                    \
+    do                                                                      \
+    {                                                                       \
+        if (!(condition))                                                   \
+        {                                                                   \
+            printf("%s:%d: check failed: %s\n", __FILE__, __LINE__, #condition); \
+            failures++;                                                     \
+        }                                                                   \
+    } while (0)
+
+extern OneWireSlave_HandleTypeDef *OneWireInstances[MAX_ONEWIRE_INSTANCES]; // see onewire-slave.c
+
+// Looks up the handle of the pin, like the EXTI handler of the STM32 implementation.
+static void Exti_Edge_Callback(void *pin, OneWire_Pin_State pin_state)
+{
+    for (int i = 0; i < MAX_ONEWIRE_INSTANCES; i++)
+    {
+        if (OneWireInstances[i] && OneWireInstances[i]->Init.Pin == (__uint32_t)(uintptr_t)pin)
+        {
+            OneWire_Interrupt_Callback(OneWireInstances[i], pin_state);
+            break;
+        }
+    }
+}
+
+//************************************
+//          THERMOMETER
+//************************************
+
+static __uint8_t Thermometer_Scratchpad[9] = {0x50, 0x05, 0x4B, 0x46, 0x7F, 0xFF, 0x0C, 0x10, 0x1C};
+static OneWire_Command_Table Thermometer_Commands;
+static OneWireSlave_HandleTypeDef Thermometer;
+
+static void Thermometer_Read_Scratchpad(OneWireSlave_HandleTypeDef *h1ws, __uint8_t command)
+{
+    (void)command;
+    OneWire_Send(h1ws, (__uint8_t *)h1ws->Init.User_Data, 9);
+}
+
+//************************************
+//          MEMORY DEVICES
+//************************************
+
+typedef struct
+{
+    __uint8_t Data[4];
+    __uint8_t Write_Pos;
+} Memory;
+
+static void Memory_Read(OneWireSlave_HandleTypeDef *h1ws, __uint8_t command)
+{
+    (void)command;
+    OneWire_Send(h1ws, ((Memory *)h1ws->Init.User_Data)->Data, 4);
+}
+
+static void Memory_Write_Byte(OneWireSlave_HandleTypeDef *h1ws, __uint8_t byte)
+{
+    Memory *memory = (Memory *)h1ws->Init.User_Data;
+    if (memory->Write_Pos < sizeof(memory->Data))
+    {
+        memory->Data[memory->Write_Pos++] = byte;
+    }
+}
+
+static void Memory_Write(OneWireSlave_HandleTypeDef *h1ws, __uint8_t command)
+{
+    (void)command;
+    ((Memory *)h1ws->Init.User_Data)->Write_Pos = 0;
+    OneWire_Set_Byte_Handler(h1ws, Memory_Write_Byte);
+}
+
+static const OneWire_Command_Table Memory_Commands = {
+    .Handlers = {
+        [0xAA] = Memory_Read,
+        [0x0F] = Memory_Write,
+    },
+};
+
+static Memory Memory_1 = {{0x11, 0x12, 0x13, 0x14}, 0};
+static Memory Memory_2 = {{0x21, 0x22, 0x23, 0x24}, 0};
+static OneWireSlave_HandleTypeDef Memory_Device_1;
+static OneWireSlave_HandleTypeDef Memory_Device_2;
+
+//************************************
+//          TEST SEQUENCE
+//************************************
+
+// Puts the master on the bus of the given pin: SKIP ROM + command. Returns the presence.
+static __uint8_t Select(__uint32_t pin, __uint8_t command)
+{
+    OneWireSim_Attach(Exti_Edge_Callback, (void *)(uintptr_t)pin);
+    __uint8_t presence = OneWireSim_Master_Reset();
+    OneWireSim_Master_Write_Byte(0xCC);
+    OneWireSim_Master_Write_Byte(command);
+    return presence;
+}
+
+static void Read_Bytes(__uint8_t *buffer, int count)
+{
+    for (int i = 0; i < count; i++)
+    {
+        buffer[i] = OneWireSim_Master_Read_Byte();
+    }
+}
+
+int main(void)
+{
+    __uint8_t buffer[9];
+
+    OneWireSim_Init(&OneWireSim_Standard_Timing);
+
+    OneWire_Register_Command_Handler(&Thermometer_Commands, 0xBE, Thermometer_Read_Scratchpad);
+    Thermometer.Init.ROM_Address = 0x1C0000000ABCDE28;
+    Thermometer.Init.Pin = 1;
+    Thermometer.Init.Command_Table = &Thermometer_Commands;
+    Thermometer.Init.User_Data = Thermometer_Scratchpad;
+    OneWireSlave_Init(&Thermometer);
+
+    Memory_Device_1.Init.ROM_Address = 0xA100000000000123;
+    Memory_Device_1.Init.Pin = 2;
+    Memory_Device_1.Init.Command_Table = &Memory_Commands;
+    Memory_Device_1.Init.User_Data = &Memory_1;
+    OneWireSlave_Init(&Memory_Device_1);
+
+    Memory_Device_2.Init.ROM_Address = 0xA200000000000223;
+    Memory_Device_2.Init.Pin = 3;
+    Memory_Device_2.Init.Command_Table = &Memory_Commands;
+    Memory_Device_2.Init.User_Data = &Memory_2;
+    OneWireSlave_Init(&Memory_Device_2);
+
+    // all of them are registered
+    CHECK(OneWireInstances[0] == &Thermometer);
+    CHECK(OneWireInstances[1] == &Memory_Device_1);
+    CHECK(OneWireInstances[2] == &Memory_Device_2);
+
+    // every device answers with its own data
+    CHECK(Select(1, 0xBE));
+    Read_Bytes(buffer, 9);
+    CHECK(memcmp(buffer, Thermometer_Scratchpad, 9) == 0);
+
+    CHECK(Select(2, 0xAA));
+    Read_Bytes(buffer, 4);
+    CHECK(memcmp(buffer, "\x11\x12\x13\x14", 4) == 0);
+
+    CHECK(Select(3, 0xAA));
+    Read_Bytes(buffer, 4);
+    CHECK(memcmp(buffer, "\x21\x22\x23\x24", 4) == 0);
+
+    // the tables are separate: the thermometer doesn't know the commands of the memory devices
+    CHECK(Select(1, 0xAA));
+    Read_Bytes(buffer, 1);
+    CHECK(buffer[0] == 0xFF);
+
+    // writing to one memory device doesn't touch the other one
+    CHECK(Select(3, 0x0F));
+    OneWireSim_Master_Write_Byte(0x31);
+    OneWireSim_Master_Write_Byte(0x32);
+    CHECK(Select(2, 0xAA));
+    Read_Bytes(buffer, 4);
+    CHECK(memcmp(buffer, "\x11\x12\x13\x14", 4) == 0);
+    CHECK(Select(3, 0xAA));
+    Read_Bytes(buffer, 4);
+    CHECK(memcmp(buffer, "\x31\x32\x23\x24", 4) == 0);
+
+    CHECK(OneWireSim_Get_Stats()->Missed_Deadlines == 0);
+
+    printf("3 handles: %s\n", (failures) ? "failed" : "ok");
+    return (failures) ? 1 : 0;
+}
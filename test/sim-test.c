@@ -0,0 +1,140 @@
+#include <stdio.h>
+#include <stdint.h>
+#include "onewire-slave-sim.h"
+
+// Host test of the link layer timing, run on the simulated bus.
+// It is built once per mode (see Makefile):
+//  - ONEWIRE_PREARMED_READ_SLOTS=0/1   software answers / pre-armed one-pulse timer
+//  - SIM_TEST_FAST                     short read slots (1 us low, sample after 2 us, 3 us interrupt latency)
+//                                      together with ONEWIRE_WRITE_ZERO_LOW_TIME=3
+
+static int failures = 0;
+
+#define CHECK(condition)                                                    \
+    do                                                                      \
+    {                                                                       \
+        if (!(condition))                                                   \
+        {                                                                   \
+            printf("%s:%d: check failed: %s\n", __FILE__, __LINE__, #condition); \
+            failures++;                                                     \
+        }                                                                   \
+    } while (0)
+
+static __uint8_t Scratchpad[9] = {0x50, 0x05, 0x4B, 0x46, 0x7F, 0xFF, 0x0C, 0x10, 0x1C};
+
+static void Read_Scratchpad(OneWireSlave_HandleTypeDef *h1ws, __uint8_t command)
+{
+    (void)command;
+    OneWire_Send(h1ws, Scratchpad, 9);
+}
+
+static OneWire_Command_Table Commands;
+static OneWireSlave_HandleTypeDef Slave;
+
+typedef struct
+{
+    __uint8_t Presence;
+    __uint32_t Wrong_Bits; // bits of the scratchpad the master read wrong
+    __uint32_t Missed;     // deadlines missed while reading the scratchpad
+    __uint8_t Search_Ok;   // the master found our ROM with SEARCH ROM
+} Result;
+
+static Result Run(const OneWireSim_TimingTypeDef *timing)
+{
+    Result result = {0, 0, 0, 1};
+
+    OneWireSim_Init(timing);
+    Slave.Init.ROM_Address = 0x1C0000000ABCDE28;
+    Slave.Init.Pin = 1;
+    Slave.Init.Command_Table = &Commands;
+    OneWireSlave_Init(&Slave);
+    OneWireSim_Attach(OneWireSim_C_Edge_Callback, &Slave);
+
+    // SKIP ROM + READ SCRATCHPAD
+    result.Presence = OneWireSim_Master_Reset();
+    OneWireSim_Master_Write_Byte(0xCC);
+    OneWireSim_Master_Write_Byte(0xBE);
+    for (int i = 0; i < 9; i++)
+    {
+        __uint8_t byte = OneWireSim_Master_Read_Byte() ^ Scratchpad[i];
+        for (; byte; byte &= byte - 1)
+        {
+            result.Wrong_Bits++;
+        }
+    }
+    result.Missed = OneWireSim_Get_Stats()->Missed_Deadlines;
+
+    // SEARCH ROM, we are the only device on the bus
+    result.Presence &= OneWireSim_Master_Reset();
+    OneWireSim_Master_Write_Byte(0xF0);
+    for (int i = 0; i < 64; i++)
+    {
+        __uint8_t bit = OneWireSim_Master_Read_Bit();
+        __uint8_t complement = OneWireSim_Master_Read_Bit();
+        if (bit == complement || bit != ((Slave.Init.ROM_Address >> i) & 1))
+        {
+            result.Search_Ok = 0;
+        }
+        OneWireSim_Master_Write_Bit(bit);
+    }
+
+    OneWireSlave_DeInit(&Slave);
+    return result;
+}
+
+static void Print(const char *name, Result result)
+{
+    const OneWireSim_StatsTypeDef *stats = OneWireSim_Get_Stats();
+    printf("%-32s presence=%u wrong_bits=%u search=%u read_slots=%u missed=%u min_rearm_margin=%d\n",
+           name, result.Presence, result.Wrong_Bits, result.Search_Ok, stats->Read_Slots, stats->Missed_Deadlines,
+           (stats->Min_Rearm_Margin == 0xFFFFFFFF) ? -1 : (int)stats->Min_Rearm_Margin);
+}
+
+int main(void)
+{
+    OneWire_Register_Command_Handler(&Commands, 0xBE, Read_Scratchpad);
+
+#ifndef SIM_TEST_FAST
+    Result result = Run(&OneWireSim_Standard_Timing);
+    Print("standard timing", result);
+    CHECK(result.Presence);
+    CHECK(result.Wrong_Bits == 0);
+    CHECK(result.Search_Ok);
+    CHECK(OneWireSim_Get_Stats()->Missed_Deadlines == 0);
+#if ONEWIRE_PREARMED_READ_SLOTS
+    // re-armed in the interrupt of the previous edge
+    CHECK(OneWireSim_Get_Stats()->Min_Rearm_Margin == OneWireSim_Standard_Timing.Recovery - OneWireSim_Standard_Timing.Interrupt_Latency);
+#endif
+#else
+    OneWireSim_TimingTypeDef fast = OneWireSim_Standard_Timing;
+    fast.Read_Low = 1;
+    fast.Read_Sample = 2;
+    fast.Slot = 10;
+    fast.Recovery = 5;
+    fast.Interrupt_Latency = 3;
+
+    Result result = Run(&fast);
+    Print("fast read slots", result);
+    CHECK(result.Presence);
+#if ONEWIRE_PREARMED_READ_SLOTS
+    CHECK(result.Wrong_Bits == 0);
+    CHECK(result.Search_Ok);
+    CHECK(OneWireSim_Get_Stats()->Missed_Deadlines == 0);
+    CHECK(OneWireSim_Get_Stats()->Min_Rearm_Margin == fast.Recovery - fast.Interrupt_Latency);
+
+    // the master doesn't give us enough time to re-arm
+    fast.Recovery = 1;
+    result = Run(&fast);
+    Print("fast read slots, short recovery", result);
+    CHECK(!result.Search_Ok);
+    CHECK(OneWireSim_Get_Stats()->Missed_Deadlines > 0);
+#else
+    // the interrupt comes after the master sampled the bus
+    CHECK(result.Wrong_Bits > 0);
+    CHECK(!result.Search_Ok);
+    CHECK(result.Missed == result.Wrong_Bits);
+#endif
+#endif
+
+    return (failures) ? 1 : 0;
+}